@@ -0,0 +1,352 @@
+#include "MergeTree.h"
+#include <mpi.h>
+#include <vtkSmartPointer.h>
+#include <vtkInformation.h>
+#include <vtkStreamingDemandDrivenPipeline.h>
+#include <vtkXMLImageDataReader.h>
+
+#define MPI_VTKIDTYPE (sizeof(vtkIdType) == sizeof(long long) ? MPI_LONG_LONG : MPI_INT)
+
+/**
+ * Return the rank owning the slice z, the slices are split evenly along the z axis.
+ */
+int sliceOwner(int z, int zDim, int numRanks){
+  int owner = (int)(((long long)z * numRanks) / zDim);
+  // move forward until the slab contains the slice
+  while(owner < numRanks-1 && (long long)(owner+1) * zDim / numRanks <= z)
+    owner++;
+  while(owner > 0 && (long long)owner * zDim / numRanks > z)
+    owner--;
+  return owner;
+}
+
+/**
+ * Get the local bridge set of the slab [zBegin, zEnd) in the local ids of the block.
+ * The block starts at slice zLow and contains the one-vertex halo of the slab.
+ */
+set<pair<vtkIdType, vtkIdType>> getSlabBridgeSet(vtkImageData *block, int zLow, int zBegin, int zEnd, int zDim){
+  set<pair<vtkIdType, vtkIdType>> bridgeSet;
+  int dimension[3];
+  block->GetDimensions(dimension);
+  vtkIdType sliceSize = (vtkIdType)dimension[0] * dimension[1];
+  float *scalars = (float *)getScalar(block);
+
+  // z edges crossing the lower and the upper boundary of the slab
+  vector<pair<int, int>> boundaries;
+  if(zBegin > 0)
+    boundaries.push_back(pair<int, int>(zBegin-1, zBegin));
+  if(zEnd < zDim)
+    boundaries.push_back(pair<int, int>(zEnd-1, zEnd));
+
+  for(auto &b : boundaries){
+    for(vtkIdType i = 0; i < sliceSize; i++){
+      pair<vtkIdType, vtkIdType> edge((b.first-zLow)*sliceSize + i, (b.second-zLow)*sliceSize + i);
+      if(scalars[edge.first] > scalars[edge.second]){
+        swap(edge.first, edge.second);
+      }else if(scalars[edge.first] == scalars[edge.second] && edge.first > edge.second){
+        swap(edge.first, edge.second);
+      }
+      bridgeSet.insert(edge);
+    }
+  }
+  return bridgeSet;
+}
+
+/**
+ * Send the vertices to their owner ranks and return the vertices received by this rank,
+ * ordered by the sending rank. The number received from each rank is stored in incomingCounts if given.
+ */
+vector<vtkIdType> exchangeVertices(const vector<vector<vtkIdType>> &outgoing, vector<int> *incomingCounts = nullptr){
+  int numRanks = outgoing.size();
+  vector<int> sendCounts(numRanks), recvCounts(numRanks), sendDispls(numRanks, 0), recvDispls(numRanks, 0);
+  for(int r = 0; r < numRanks; r++)
+    sendCounts[r] = outgoing[r].size();
+  MPI_Alltoall(sendCounts.data(), 1, MPI_INT, recvCounts.data(), 1, MPI_INT, MPI_COMM_WORLD);
+
+  for(int r = 1; r < numRanks; r++){
+    sendDispls[r] = sendDispls[r-1] + sendCounts[r-1];
+    recvDispls[r] = recvDispls[r-1] + recvCounts[r-1];
+  }
+
+  vector<vtkIdType> sendBuffer;
+  for(auto &vertices : outgoing)
+    sendBuffer.insert(sendBuffer.end(), vertices.begin(), vertices.end());
+  vector<vtkIdType> recvBuffer(recvDispls[numRanks-1] + recvCounts[numRanks-1]);
+
+  MPI_Alltoallv(sendBuffer.data(), sendCounts.data(), sendDispls.data(), MPI_VTKIDTYPE,
+                recvBuffer.data(), recvCounts.data(), recvDispls.data(), MPI_VTKIDTYPE, MPI_COMM_WORLD);
+  if(incomingCounts)
+    *incomingCounts = recvCounts;
+  return recvBuffer;
+}
+
+/**
+ * Write the labels of a slab into the raw label volume at the given vertex offset.
+ */
+void writeLabels(const char *filename, const vtkIdType *labels, vtkIdType offset, vtkIdType count){
+  MPI_File file;
+  if(MPI_File_open(MPI_COMM_WORLD, filename, MPI_MODE_CREATE | MPI_MODE_WRONLY, MPI_INFO_NULL, &file) != MPI_SUCCESS){
+    fprintf(stderr, "Cannot open %s for writing!\n", filename);
+    MPI_Abort(MPI_COMM_WORLD, 6);
+  }
+  // drop the stale labels of an existing file before any rank writes
+  MPI_File_set_size(file, 0);
+  MPI_Barrier(MPI_COMM_WORLD);
+  // write in chunks since the count of a single write is an int
+  const vtkIdType chunkSize = 1 << 28;
+  for(vtkIdType written = 0; written < count; written += chunkSize){
+    int chunk = (int)min(chunkSize, count - written);
+    MPI_File_write_at(file, (MPI_Offset)(offset + written) * sizeof(vtkIdType), labels + written, chunk, MPI_VTKIDTYPE, MPI_STATUS_IGNORE);
+  }
+  MPI_File_close(&file);
+}
+
+int main ( int argc, char *argv[] )
+{
+  MPI_Init(&argc, &argv);
+  int rank, numRanks;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &numRanks);
+
+  // parse command line arguments
+  if(argc < 2){
+    if(rank == 0)
+      fprintf(stderr, "Usage: %s Filename(.vti) [VertexId] [Output(.raw)]\n", argv[0]);
+    MPI_Finalize();
+    return 1;
+  }
+
+  string filename = argv[1];
+  string extension = filename.substr(filename.length() - 3);
+
+  if(extension != "vti"){
+    if(rank == 0)
+      fprintf(stderr, "The file extension should be .vti!\n");
+    MPI_Finalize();
+    return 2;
+  }
+
+  vtkSmartPointer<vtkXMLImageDataReader> reader = vtkSmartPointer<vtkXMLImageDataReader>::New();
+  reader->SetFileName(filename.c_str());
+  reader->UpdateInformation();
+
+  int wholeExtent[6];
+  reader->GetOutputInformation(0)->Get(vtkStreamingDemandDrivenPipeline::WHOLE_EXTENT(), wholeExtent);
+  int dimension[3] = {wholeExtent[1]-wholeExtent[0]+1, wholeExtent[3]-wholeExtent[2]+1, wholeExtent[5]-wholeExtent[4]+1};
+  vtkIdType sliceSize = (vtkIdType)dimension[0] * dimension[1];
+
+  if(numRanks > dimension[2]){
+    if(rank == 0)
+      fprintf(stderr, "The number of ranks should not exceed the number of slices (%d)!\n", dimension[2]);
+    MPI_Finalize();
+    return 3;
+  }
+
+  // Each rank owns the slab [zBegin, zEnd) and reads it with a one-vertex halo
+  int zBegin = (int)((long long)rank * dimension[2] / numRanks);
+  int zEnd = (int)((long long)(rank+1) * dimension[2] / numRanks);
+  int zLow = max(zBegin-1, 0);
+  int zHigh = min(zEnd, dimension[2]-1);
+
+  auto start = chrono::high_resolution_clock::now();
+  int blockExtent[6] = {wholeExtent[0], wholeExtent[1], wholeExtent[2], wholeExtent[3], wholeExtent[4]+zLow, wholeExtent[4]+zHigh};
+  reader->UpdateExtent(blockExtent);
+  vtkImageData *block = reader->GetOutput();
+  auto stop = chrono::high_resolution_clock::now();
+  auto duration = chrono::duration_cast<chrono::milliseconds>(stop - start);
+  if(rank == 0){
+    printf("There are %lld points in the data.\n", (long long)sliceSize * dimension[2]);
+    printf("Read block cost: %lld\n", (long long)duration.count());
+  }
+
+  // local id = global id - blockOffset
+  vtkIdType blockOffset = zLow * sliceSize;
+  region slab((zBegin-zLow) * sliceSize, (zEnd-zBegin) * sliceSize);
+  if(slab.extent >= numeric_limits<uint32_t>::max()){
+    fprintf(stderr, "Rank %d: the slab size should be less than 2^32, please use more ranks!\n", rank);
+    MPI_Abort(MPI_COMM_WORLD, 5);
+  }
+
+  // Construct the local merge tree and the local bridge set
+  start = chrono::high_resolution_clock::now();
+  MergeTree<uint32_t> localMergeTree(block, slab);
+  localMergeTree.build();
+  set<pair<vtkIdType, vtkIdType>> localBS = getSlabBridgeSet(block, zLow, zBegin, zEnd, dimension[2]);
+  stop = chrono::high_resolution_clock::now();
+  duration = chrono::duration_cast<chrono::milliseconds>(stop - start);
+  printf("Rank %d build tree cost: %lld\n", rank, (long long)duration.count());
+
+  // Maxima query, gather the maxima of all regions on rank 0
+  vector<vtkIdType> regionMaxima = localMergeTree.MaximaQuery(localBS);
+  for(vtkIdType &v : regionMaxima)
+    v += blockOffset;
+
+  int maximaCount = regionMaxima.size();
+  vector<int> maximaCounts(numRanks), maximaDispls(numRanks, 0);
+  MPI_Gather(&maximaCount, 1, MPI_INT, maximaCounts.data(), 1, MPI_INT, 0, MPI_COMM_WORLD);
+  for(int r = 1; r < numRanks; r++)
+    maximaDispls[r] = maximaDispls[r-1] + maximaCounts[r-1];
+  vector<vtkIdType> maxima(rank == 0? maximaDispls[numRanks-1] + maximaCounts[numRanks-1]: 0);
+  MPI_Gatherv(regionMaxima.data(), maximaCount, MPI_VTKIDTYPE, maxima.data(), maximaCounts.data(), maximaDispls.data(), MPI_VTKIDTYPE, 0, MPI_COMM_WORLD);
+
+  if(rank == 0){
+    printf("The size of the maxima is %zu\n", maxima.size());
+    printf("Maxima: [");
+    for (size_t i = 0; i < maxima.size(); i++) {
+      printf(" %lld ", (long long)maxima[i]);
+    }
+    printf("]\n");
+  }
+
+  // Component maximum query, the component is traversed through the bridge edges
+  vtkIdType v = argc > 2? atoll(argv[2]): 0;
+  if(v < 0 || v >= sliceSize * dimension[2]){
+    if(rank == 0)
+      fprintf(stderr, "The vertex id should be in the range [0, %lld)!\n", (long long)sliceSize * dimension[2]);
+    MPI_Finalize();
+    return 4;
+  }
+  int vOwner = sliceOwner(v / sliceSize, dimension[2], numRanks);
+  float *scalars = (float *)getScalar(block);
+  float level = 0;
+  if(rank == vOwner)
+    level = scalars[v - blockOffset];
+  MPI_Bcast(&level, 1, MPI_FLOAT, vOwner, MPI_COMM_WORLD);
+
+  // bridges leaving the region, indexed by the vertex inside the region
+  unordered_map<vtkIdType, vector<vtkIdType>> bridges;
+  for(auto &edge : localBS){
+    if(slab.contains(edge.first))
+      bridges[edge.first].push_back(edge.second);
+    else
+      bridges[edge.second].push_back(edge.first);
+  }
+
+  start = chrono::high_resolution_clock::now();
+  set<vtkIdType> visited;
+  vector<vtkIdType> seeds;
+  if(rank == vOwner)
+    seeds.push_back(v - blockOffset);
+  vtkIdType compMax = -1;
+  long long pending;
+  do{
+    vector<vtkIdType> reached;
+    vtkIdType localMax = localMergeTree.ComponentMaximumQuery(seeds, level, visited, reached);
+    if(localMax != -1 && (compMax == -1 || scalars[localMax] > scalars[compMax] || (scalars[localMax] == scalars[compMax] && localMax > compMax)))
+      compMax = localMax;
+
+    // continue the traversal in the neighbor regions
+    vector<vector<vtkIdType>> outgoing(numRanks);
+    for(vtkIdType vi : reached){
+      auto it = bridges.find(vi);
+      if(it == bridges.end())
+        continue;
+      for(vtkIdType vj : it->second){
+        if(scalars[vj] > level){
+          vtkIdType globalId = vj + blockOffset;
+          outgoing[sliceOwner(globalId / sliceSize, dimension[2], numRanks)].push_back(globalId);
+        }
+      }
+    }
+    long long sent = 0;
+    for(auto &vertices : outgoing)
+      sent += vertices.size();
+    MPI_Allreduce(&sent, &pending, 1, MPI_LONG_LONG, MPI_SUM, MPI_COMM_WORLD);
+
+    seeds = exchangeVertices(outgoing);
+    for(vtkIdType &vi : seeds)
+      vi -= blockOffset;
+  }while(pending > 0);
+
+  // reduce the component maximum, ties are broken by the larger vertex id
+  float localValue = compMax == -1? -FLT_MAX: scalars[compMax];
+  float globalValue;
+  MPI_Allreduce(&localValue, &globalValue, 1, MPI_FLOAT, MPI_MAX, MPI_COMM_WORLD);
+  long long localId = (compMax != -1 && localValue == globalValue)? (long long)(compMax + blockOffset): -1;
+  long long globalId;
+  MPI_Allreduce(&localId, &globalId, 1, MPI_LONG_LONG, MPI_MAX, MPI_COMM_WORLD);
+  stop = chrono::high_resolution_clock::now();
+  duration = chrono::duration_cast<chrono::milliseconds>(stop - start);
+
+  if(rank == 0){
+    printf("Component maximum query cost: %lld\n", (long long)duration.count());
+    printf("The component maximum of vertex %lld is %lld\n", (long long)v, globalId);
+  }
+
+  // Steepest-ascent segmentation, label every vertex with the maximum reached by its ascent
+  start = chrono::high_resolution_clock::now();
+  vector<vtkIdType> labels(block->GetNumberOfPoints(), -1);
+  vector<pair<vtkIdType, vtkIdType>> regionCrossings = steepestAscentSegmentation(block, slab, labels.data());
+  for(vtkIdType vi = slab.begin; vi < slab.end(); vi++)
+    labels[vi] += blockOffset;
+
+  // the vertices whose ascent leaves the slab, and the vertex their ascent has reached so far
+  unordered_map<vtkIdType, vtkIdType> up, resolved;
+  for(auto &c : regionCrossings)
+    up[c.first + blockOffset] = c.second + blockOffset;
+
+  // ask the owner of the reached vertex for its label in rounds, the owner answers with the final label
+  // or with the vertex reached by its own crossing, so the chains are shortened by pointer jumping
+  long long unresolved = up.size();
+  MPI_Allreduce(MPI_IN_PLACE, &unresolved, 1, MPI_LONG_LONG, MPI_SUM, MPI_COMM_WORLD);
+  while(unresolved > 0){
+    vector<vector<vtkIdType>> requests(numRanks), askers(numRanks);
+    for(auto &c : up){
+      int owner = sliceOwner(c.second / sliceSize, dimension[2], numRanks);
+      requests[owner].push_back(c.second);
+      askers[owner].push_back(c.first);
+    }
+    vector<int> requestCounts;
+    vector<vtkIdType> received = exchangeVertices(requests, &requestCounts);
+
+    // answer with a pair of the label and whether it is final
+    vector<vector<vtkIdType>> answers(numRanks);
+    size_t next = 0;
+    for(int r = 0; r < numRanks; r++){
+      for(int i = 0; i < requestCounts[r]; i++, next++){
+        vtkIdType label = labels[received[next] - blockOffset];
+        auto it = up.find(label);
+        if(it != up.end()){
+          answers[r].push_back(it->second);
+          answers[r].push_back(0);
+        }else{
+          auto rt = resolved.find(label);
+          answers[r].push_back(rt != resolved.end()? rt->second: label);
+          answers[r].push_back(1);
+        }
+      }
+    }
+    vector<vtkIdType> replies = exchangeVertices(answers);
+
+    // the replies arrive in the order of the requests
+    next = 0;
+    for(int r = 0; r < numRanks; r++){
+      for(vtkIdType c : askers[r]){
+        if(replies[next+1]){
+          resolved[c] = replies[next];
+          up.erase(c);
+        }else{
+          up[c] = replies[next];
+        }
+        next += 2;
+      }
+    }
+
+    unresolved = up.size();
+    MPI_Allreduce(MPI_IN_PLACE, &unresolved, 1, MPI_LONG_LONG, MPI_SUM, MPI_COMM_WORLD);
+  }
+  relabelRegion(labels.data(), slab, resolved);
+  stop = chrono::high_resolution_clock::now();
+  duration = chrono::duration_cast<chrono::milliseconds>(stop - start);
+  if(rank == 0)
+    printf("Segmentation cost: %lld\n", (long long)duration.count());
+
+  if(argc > 3){
+    writeLabels(argv[3], labels.data() + slab.begin, zBegin * sliceSize, slab.extent);
+    if(rank == 0)
+      printf("Segmentation is written to %s\n", argv[3]);
+  }
+
+  MPI_Finalize();
+  return 0;
+}
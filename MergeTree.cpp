@@ -3,43 +3,48 @@
 /**
  * Constructor.
  */ 
-MergeTree::MergeTree(vtkImageData *p){
+template<typename IndexType>
+MergeTree<IndexType>::MergeTree(vtkImageData *p){
   sgrid = p;
-  vertexList = vector<vtkIdType>(sgrid->GetNumberOfPoints());
-  iota(vertexList.begin(), vertexList.end(), 0);
+  vertexRange = region(0, sgrid->GetNumberOfPoints());
   sgrid->GetDimensions(dimension);
 }
 
-MergeTree::MergeTree(vtkImageData *p, vector<vtkIdType> idlist){
+template<typename IndexType>
+MergeTree<IndexType>::MergeTree(vtkImageData *p, const region &r){
   sgrid = p;
-  vertexList = idlist;
+  vertexRange = r;
   sgrid->GetDimensions(dimension);
 }
 
 /**
  *  A wrapper function to build the merge tree.
  */ 
-int MergeTree::build(){
+template<typename IndexType>
+int MergeTree<IndexType>::build(){
   // auto start = chrono::high_resolution_clock::now();
-  vector<size_t> sortedIndices = indexSort(vertexList, sgrid);
+  vector<IndexType> sortedIndices = indexSort<IndexType>(vertexRange, sgrid);
   // auto stop = chrono::high_resolution_clock::now();
   // auto duration = chrono::duration_cast<chrono::microseconds>(stop - start);
   // printf("Index sort cost: %lld\n", duration.count());
 
   // start = chrono::high_resolution_clock::now();
-  constructJoin(sortedIndices);
+  sweepTree<IndexType> joinTree(sortedIndices.size());
+  constructJoin(sortedIndices, joinTree);
   // stop = chrono::high_resolution_clock::now();
   // duration = chrono::duration_cast<chrono::microseconds>(stop - start);
   // printf("Join tree cost: %lld\n", duration.count());
 
   // start = chrono::high_resolution_clock::now();
-  constructSplit(sortedIndices);
+  sweepTree<IndexType> splitTree(sortedIndices.size());
+  constructSplit(sortedIndices, splitTree);
+  vector<IndexType>().swap(sortedIndices);
   // stop = chrono::high_resolution_clock::now();
   // duration = chrono::duration_cast<chrono::microseconds>(stop - start);
   // printf("Split tree cost: %lld\n", duration.count());
 
   // start = chrono::high_resolution_clock::now();
-  mergeJoinSplit();
+  mergeJoinSplit(joinTree, splitTree);
   // stop = chrono::high_resolution_clock::now();
   // duration = chrono::duration_cast<chrono::microseconds>(stop - start);
   // printf("Merge tree cost: %lld\n", duration.count());
@@ -50,31 +55,30 @@ int MergeTree::build(){
 /**
  * Construct the join tree.
  */ 
-void MergeTree::constructJoin(vector<size_t>& sortedIndices){
+template<typename IndexType>
+void MergeTree<IndexType>::constructJoin(const vector<IndexType>& sortedIndices, sweepTree<IndexType>& joinTree){
   float *scalars = (float *)getScalar(sgrid);
-  int regionSize = sortedIndices.size();
-  vector<vtkIdType> component(regionSize, -1);
+  IndexType regionSize = sortedIndices.size();
+  vector<IndexType> component(regionSize, (IndexType)-1);
 
-  joinTree = vector<node*>(regionSize, nullptr);
-  for(int i = 0; i < regionSize; i++){
-    size_t idx = sortedIndices[i];
-    node *newnode = new node(idx);
-    joinTree[idx] = newnode;
+  vtkIdType neighbors[6];
+  for(IndexType i = 0; i < regionSize; i++){
+    IndexType idx = sortedIndices[i];
 
-    vector<vtkIdType> neighbors = getConnectedVertices(vertexList[idx], sgrid, dimension);
-    for(vtkIdType &vj : neighbors){
+    int neighborCount = getConnectedVertices(vertexRange.begin+idx, sgrid, dimension, neighbors);
+    for(int n = 0; n < neighborCount; n++){
+      vtkIdType vj = neighbors[n];
       // see if the vertex is in the range
-      if(vj < vertexList.front() || vj > vertexList.back()) 
+      if(!vertexRange.contains(vj))
         continue;
-      if((scalars[vj] < scalars[vertexList[idx]]) || (scalars[vj] == scalars[vertexList[idx]] && vj < vertexList[idx])){
+      if((scalars[vj] < scalars[vertexRange.begin+idx]) || (scalars[vj] == scalars[vertexRange.begin+idx] && vj < vertexRange.begin+idx)){
         // find the set of vi and vj
         // the scalar value of j should be lower
-        vtkIdType iset = findSet(component, idx);
-        vtkIdType jset = findSet(component, vj-vertexList.front());
+        IndexType iset = findSet(component, idx);
+        IndexType jset = findSet(component, (IndexType)(vj-vertexRange.begin));
 
         if(iset != jset){
-          joinTree[jset]->parent = joinTree[iset];
-          joinTree[iset]->children.push_back(joinTree[jset]);
+          joinTree.link(jset, iset);
           unionSet(component, iset, jset);
         }
       }
@@ -86,30 +90,29 @@ void MergeTree::constructJoin(vector<size_t>& sortedIndices){
 /**
  * Construct the split tree.
  */ 
-void MergeTree::constructSplit(vector<size_t>& sortedIndices){
+template<typename IndexType>
+void MergeTree<IndexType>::constructSplit(const vector<IndexType>& sortedIndices, sweepTree<IndexType>& splitTree){
   float *scalars = (float *)getScalar(sgrid);
-  int regionSize = sortedIndices.size();
-  vector<vtkIdType> component(regionSize, -1);
+  IndexType regionSize = sortedIndices.size();
+  vector<IndexType> component(regionSize, (IndexType)-1);
 
-  splitTree = vector<node*>(regionSize, nullptr);
-  for(int i = regionSize-1; i >= 0; i--){
-    size_t idx = sortedIndices[i];
-    node *newnode = new node(idx);
-    splitTree[idx] = newnode;
+  vtkIdType neighbors[6];
+  for(IndexType i = regionSize; i-- > 0; ){
+    IndexType idx = sortedIndices[i];
 
-    vector<vtkIdType> neighbors = getConnectedVertices(vertexList[idx], sgrid, dimension);
-    for(vtkIdType &vj : neighbors){
+    int neighborCount = getConnectedVertices(vertexRange.begin+idx, sgrid, dimension, neighbors);
+    for(int n = 0; n < neighborCount; n++){
+      vtkIdType vj = neighbors[n];
       // find the set of vi and vj
       // the scalar value of j should be greater
-      if (vj < vertexList.front() || vj > vertexList.back())
+      if(!vertexRange.contains(vj))
         continue;
-      if((scalars[vj] > scalars[vertexList[idx]]) || (scalars[vj] == scalars[vertexList[idx]] && vj > vertexList[idx])){
-          vtkIdType iset = findSet(component, idx);
-          vtkIdType jset = findSet(component, vj-vertexList.front());
+      if((scalars[vj] > scalars[vertexRange.begin+idx]) || (scalars[vj] == scalars[vertexRange.begin+idx] && vj > vertexRange.begin+idx)){
+          IndexType iset = findSet(component, idx);
+          IndexType jset = findSet(component, (IndexType)(vj-vertexRange.begin));
 
           if(iset != jset){
-            splitTree[jset]->parent = splitTree[iset];
-            splitTree[iset]->children.push_back(splitTree[jset]);
+            splitTree.link(jset, iset);
             unionSet(component, iset, jset);
           }
       }
@@ -121,91 +124,76 @@ void MergeTree::constructSplit(vector<size_t>& sortedIndices){
 
 /**
  * Merge the split and join tree.
+ * The arcs are collected in the parent array first, and the children of each vertex
+ * are laid out afterwards so that no per-vertex list is allocated.
  */ 
-void MergeTree::mergeJoinSplit(){
+template<typename IndexType>
+void MergeTree<IndexType>::mergeJoinSplit(sweepTree<IndexType>& joinTree, sweepTree<IndexType>& splitTree){
   
-  queue<int> leavesQueue;
-  mergeTree = vector<node*>(joinTree.size(), nullptr);
+  queue<IndexType> leavesQueue;
+  IndexType regionSize = joinTree.parent.size();
+  mergeParent = vector<IndexType>(regionSize, (IndexType)-1);
 
   // construct a queue of leaves
-  for(unsigned int i = 0; i < joinTree.size(); ++i){
-    node *ci = new node(i);
-    mergeTree.at(i) = ci;
-    if(joinTree[i]->children.size() + splitTree[i]->children.size() == 1){
+  for(IndexType i = 0; i < regionSize; ++i){
+    if(joinTree.childCount[i] + splitTree.childCount[i] == 1){
       leavesQueue.push(i);
     }
   }
 
   while (!leavesQueue.empty()){
-    int i = leavesQueue.front();
+    IndexType i = leavesQueue.front();
     leavesQueue.pop();
-    vtkIdType k;
-    // if ai is the lower leaf, i.e., from the join tree
-    if(joinTree[i]->children.size() == 0){
-      // add (ai, bi) to the merge tree
-      k = joinTree[i]->parent->vtkIdx;
-      mergeTree[i]->parent = mergeTree[k]; 
-      mergeTree[k]->children.push_back(mergeTree[i]);
+    // skip the vertices that are removed already or no longer leaves,
+    // e.g. the last two vertices are both enqueued as leaves
+    if(joinTree.childCount[i] + splitTree.childCount[i] != 1)
+      continue;
+    // if ai is the lower leaf, i.e., from the join tree, bi is its parent in the join tree
+    bool lowerLeaf = joinTree.childCount[i] == 0;
+    IndexType k = lowerLeaf? joinTree.parent[i]: splitTree.parent[i];
+    if(k == (IndexType)-1)
+      continue;
 
+    // add (ai, bi) to the merge tree
+    mergeParent[i] = k;
+    if(lowerLeaf){
       // delete ai from join tree
-      auto it = find(joinTree[i]->parent->children.begin(), joinTree[i]->parent->children.end(),joinTree[i]);
-      joinTree[i]->parent->children.erase(it);
-      joinTree[i] = nullptr;
-
-      // delete ai from split tree
-      // connect bi's parent with bi's children
-      // if ai is the root of split tree, just make its children's parents to null
-      if(!splitTree[i]->parent){
-        for(auto child : splitTree[i]->children){
-          child->parent = nullptr;
-        }
-      }else{
-        it = find(splitTree[i]->parent->children.begin(), splitTree[i]->parent->children.end(), splitTree[i]);
-        splitTree[i]->parent->children.erase(it);
-
-        for(auto child : splitTree[i]->children){
-          child->parent = splitTree[i]->parent;
-          splitTree[i]->parent->children.push_back(child);
-        }
-      }
-      splitTree[i] = nullptr;
+      joinTree.cut(i);
+      // delete ai from split tree, connect ai's parent with ai's only child
+      splitTree.splice(i);
 
     // if vi is the upper leaf, i.e., from the split tree
     }else{
-      // add (ai, bi) to the merge tree
-      k = splitTree[i]->parent->vtkIdx;
-      mergeTree[i]->parent = mergeTree[k];
-      mergeTree[k]->children.push_back(mergeTree[i]);
-
       //delete ai from split tree
-      auto it = find(splitTree[i]->parent->children.begin(), splitTree[i]->parent->children.end(), splitTree[i]);
-      splitTree[i]->parent->children.erase(it);
-      splitTree[i] = nullptr;
-
-      // delete ai from the join tree
-      // connect bi's parent with bi's children
-      // if bi is the root of join tree, just make its children's parents to null
-       if(!joinTree[i]->parent){
-        for(auto child : joinTree[i]->children){
-          child->parent = nullptr;
-        }
-      }else{
-        it = find(joinTree[i]->parent->children.begin(), joinTree[i]->parent->children.end(),joinTree[i]);
-        joinTree[i]->parent->children.erase(it);
-        
-        for(auto child : joinTree[i]->children){
-          child->parent = joinTree[i]->parent;
-          joinTree[i]->parent->children.push_back(child);
-        }
-      }
-      joinTree[i] = nullptr;
+      splitTree.cut(i);
+      // delete ai from the join tree, connect ai's parent with ai's only child
+      joinTree.splice(i);
     }
     // if bi is a leaf, then enqueue
-    if(joinTree[k]->children.size() + splitTree[k]->children.size() == 1){
+    if(joinTree.childCount[k] + splitTree.childCount[k] == 1){
       leavesQueue.push(k);
     }
   }
 
+  // the join and split trees are no longer needed, free them before laying out the children
+  joinTree = sweepTree<IndexType>(0);
+  splitTree = sweepTree<IndexType>(0);
+  queue<IndexType>().swap(leavesQueue);
+
+  childBegin = vector<IndexType>(regionSize + 1, 0);
+  for(IndexType i = 0; i < regionSize; i++){
+    if(mergeParent[i] != (IndexType)-1)
+      childBegin[mergeParent[i] + 1]++;
+  }
+  for(IndexType i = 0; i < regionSize; i++)
+    childBegin[i + 1] += childBegin[i];
+  mergeChildren = vector<IndexType>(childBegin[regionSize]);
+  vector<IndexType> filled(childBegin.begin(), childBegin.end() - 1);
+  for(IndexType i = 0; i < regionSize; i++){
+    if(mergeParent[i] != (IndexType)-1)
+      mergeChildren[filled[mergeParent[i]]++] = i;
+  }
+
   // printf("Merge tree built!\n");
 }
 
@@ -213,23 +201,32 @@ void MergeTree::mergeJoinSplit(){
 /**
  * Return all local maxima in the simplicial complex.
  */ 
-vector<vtkIdType> MergeTree::MaximaQuery(const set<pair<vtkIdType, vtkIdType>> &bridgeSet){
-  // collect the higher end vertices from the bridge set
+template<typename IndexType>
+vector<vtkIdType> MergeTree<IndexType>::MaximaQuery(const set<pair<vtkIdType, vtkIdType>> &bridgeSet){
+  // collect the lower end vertices from the bridge set
   set<vtkIdType> lowEndVertices;
   float* scalarData = (float*) getScalar(sgrid);
   for(auto it = bridgeSet.begin(); it != bridgeSet.end(); it++){
-    lowEndVertices.insert(it->first);   // the lower end vertex has the smaller scalar value
-    if(scalarData[it->first] == scalarData[it->second])
-      lowEndVertices.insert(it->second);
+    lowEndVertices.insert(it->first);   // the lower end vertex, ties are already broken by the vertex id
   }
+  // compare two vertices, ties are broken by the vertex id as in the join and split trees
+  auto higher = [scalarData](vtkIdType a, vtkIdType b){
+    return scalarData[a] > scalarData[b] || (scalarData[a] == scalarData[b] && a > b);
+  };
 
   vector<vtkIdType> maxima;
   //iterate mergeTree to find local maximum
-  for(auto node:mergeTree){
-    if(node->children.size() == 0 && scalarData[vertexList[node->parent->vtkIdx]] < scalarData[vertexList[node->vtkIdx]]){
-      if(lowEndVertices.find(vertexList[node->vtkIdx]) == lowEndVertices.end())
-        maxima.push_back(vertexList[node->vtkIdx]);
+  //the parent is not always the higher end of an arc, so check all the neighbors
+  IndexType regionSize = mergeParent.size();
+  for(IndexType i = 0; i < regionSize; i++){
+    vtkIdType vi = vertexRange.begin+i;
+    bool isMaximum = mergeParent[i] == (IndexType)-1 || higher(vi, vertexRange.begin+mergeParent[i]);
+    for(IndexType c = childBegin[i]; c < childBegin[i+1]; c++){
+      if(!higher(vi, vertexRange.begin+mergeChildren[c]))
+        isMaximum = false;
     }
+    if(isMaximum && lowEndVertices.find(vi) == lowEndVertices.end())
+      maxima.push_back(vi);
   }
   return maxima;
 }
@@ -237,28 +234,77 @@ vector<vtkIdType> MergeTree::MaximaQuery(const set<pair<vtkIdType, vtkIdType>> &
 /**
  * Return the vertex within the superlevel component that has maximum scalar function value.
  */ 
-vtkIdType MergeTree::ComponentMaximumQuery(vtkIdType& v, float& level){
-  queue<node*> nodes;
+template<typename IndexType>
+vtkIdType MergeTree<IndexType>::ComponentMaximumQuery(vtkIdType& v, float& level){
+  queue<IndexType> nodes;
   set<vtkIdType> visitedVertices;
   float* scalarData = (float*) getScalar(sgrid);
   if(scalarData[v] < level)
     return v;
   vtkIdType compMax = v;
 
-  nodes.push(mergeTree[v]);
+  nodes.push(v-vertexRange.begin);
   while(nodes.size()){
-    node* n = nodes.front();
+    IndexType n = nodes.front();
     nodes.pop();
-    visitedVertices.insert(n->vtkIdx);
+    vtkIdType vn = vertexRange.begin+n;
+    visitedVertices.insert(vn);
 
-    compMax = scalarData[n->vtkIdx] > scalarData[compMax]? n->vtkIdx: compMax;
+    compMax = scalarData[vn] > scalarData[compMax]? vn: compMax;
     
-    if(n->parent && scalarData[n->parent->vtkIdx] > level && visitedVertices.find(n->parent->vtkIdx) == visitedVertices.end())
-        nodes.push(n->parent);
-    for(auto child : n->children){
-      if(scalarData[child->vtkIdx] > level && visitedVertices.find(child->vtkIdx) == visitedVertices.end())
+    IndexType p = mergeParent[n];
+    if(p != (IndexType)-1 && scalarData[vertexRange.begin+p] > level && visitedVertices.find(vertexRange.begin+p) == visitedVertices.end())
+        nodes.push(p);
+    for(IndexType c = childBegin[n]; c < childBegin[n+1]; c++){
+      IndexType child = mergeChildren[c];
+      if(scalarData[vertexRange.begin+child] > level && visitedVertices.find(vertexRange.begin+child) == visitedVertices.end())
+        nodes.push(child);
+    }
+  }
+  return compMax;
+}
+
+/**
+ * Return the vertex with maximum scalar function value among the superlevel
+ * components reached from the seed vertices inside this region.
+ * Seeds already in the visited set are skipped, and every newly reached vertex is
+ * appended to reached so that the caller can continue through the bridge edges.
+ * Return -1 if no new vertex is reached.
+ */
+template<typename IndexType>
+vtkIdType MergeTree<IndexType>::ComponentMaximumQuery(const vector<vtkIdType>& seeds, float level, set<vtkIdType>& visited, vector<vtkIdType>& reached){
+  queue<IndexType> nodes;
+  float* scalarData = (float*) getScalar(sgrid);
+  vtkIdType compMax = -1;
+
+  for(vtkIdType v : seeds){
+    // skip the seeds outside of the region
+    if(!vertexRange.contains(v))
+      continue;
+    if(visited.insert(v).second)
+      nodes.push(v-vertexRange.begin);
+  }
+
+  while(nodes.size()){
+    IndexType n = nodes.front();
+    nodes.pop();
+    vtkIdType vi = vertexRange.begin+n;
+    reached.push_back(vi);
+
+    if(compMax == -1 || scalarData[vi] > scalarData[compMax] || (scalarData[vi] == scalarData[compMax] && vi > compMax))
+      compMax = vi;
+
+    IndexType p = mergeParent[n];
+    if(p != (IndexType)-1 && scalarData[vertexRange.begin+p] > level && visited.insert(vertexRange.begin+p).second)
+      nodes.push(p);
+    for(IndexType c = childBegin[n]; c < childBegin[n+1]; c++){
+      IndexType child = mergeChildren[c];
+      if(scalarData[vertexRange.begin+child] > level && visited.insert(vertexRange.begin+child).second)
         nodes.push(child);
     }
   }
   return compMax;
 }
+
+template class MergeTree<uint32_t>;
+template class MergeTree<vtkIdType>;
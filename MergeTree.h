@@ -5,11 +5,40 @@
 
 using namespace std;
 
-struct node{
-  vtkIdType vtkIdx;
-  node *parent;
-  vector<node *> children;
-  node(vtkIdType id):vtkIdx(id), parent(nullptr), children(vector<node *>()){}
+/**
+ * A tree over the region-local indices built by the sweeps, stored in arrays instead of
+ * linked nodes. The children of a vertex are only kept as their number and the xor of
+ * their indices, which is enough to cut a leaf or to splice out a vertex with one child.
+ */
+template<typename IndexType>
+struct sweepTree{
+  vector<IndexType> parent;   // (IndexType)-1 for the roots
+  vector<IndexType> childXor;
+  vector<uint8_t> childCount;   // bounded by the number of neighbors in the grid
+
+  sweepTree(IndexType size):parent(size, (IndexType)-1), childXor(size, 0), childCount(size, 0){}
+  void link(IndexType child, IndexType p){
+    parent[child] = p;
+    childXor[p] ^= child;
+    childCount[p]++;
+  }
+  // remove a vertex without children
+  void cut(IndexType i){
+    IndexType p = parent[i];
+    childXor[p] ^= i;
+    childCount[p]--;
+    parent[i] = (IndexType)-1;
+  }
+  // remove a vertex with a single child, the child is attached to the parent of the vertex
+  void splice(IndexType i){
+    IndexType child = childXor[i], p = parent[i];
+    parent[child] = p;
+    if(p != (IndexType)-1)
+      childXor[p] ^= i ^ child;
+    parent[i] = (IndexType)-1;
+    childXor[i] = 0;
+    childCount[i] = 0;
+  }
 };
 
 
@@ -17,28 +46,32 @@ struct node{
  * Merge Tree Class.
  * The merge tree is created by combining join tree and split tree, which 
  * captures the evolution of the superlevel or sublevel sets.
+ * IndexType is the type of the region-local indices the trees are stored in,
+ * uint32_t halves the memory of the trees for regions under 4G vertices.
  */ 
+template<typename IndexType>
 class MergeTree{
   public:
     MergeTree(vtkImageData*);
-    MergeTree(vtkImageData*, vector<vtkIdType>);
+    MergeTree(vtkImageData*, const region&);
     int build();  // Wrap function for compute JT, ST and CT
     vector<vtkIdType> MaximaQuery(const set<pair<vtkIdType, vtkIdType>> &);   // return all local maxima in the simplicial complex
     vtkIdType ComponentMaximumQuery(vtkIdType&, float&);  // return vertexId within the superlevel component that has maximum scalar function value
+    vtkIdType ComponentMaximumQuery(const vector<vtkIdType>&, float, set<vtkIdType>&, vector<vtkIdType>&);  // multi-seed variant used when the component spans several regions
   
   protected:
     vtkImageData* sgrid;  // Unstructed grid
 
   private:
     int dimension[3];
-    vector<vtkIdType> vertexList;
-    void constructJoin(vector<size_t>&);   // Construct the join tree.
-    void constructSplit(vector<size_t>&);  // Construct the split tree.
-    void mergeJoinSplit();  // Merge the split and join tree.
-  
-    vector<node*> joinTree;   // Represent the join tree
-    vector<node*> splitTree;  // Represent the split tree
-    vector<node*> mergeTree;   
+    region vertexRange;   // [begin, begin+extent) of the vertex ids in the region
+    void constructJoin(const vector<IndexType>&, sweepTree<IndexType>&);   // Construct the join tree.
+    void constructSplit(const vector<IndexType>&, sweepTree<IndexType>&);  // Construct the split tree.
+    void mergeJoinSplit(sweepTree<IndexType>&, sweepTree<IndexType>&);  // Merge the split and join tree.
+
+    vector<IndexType> mergeParent;    // parent of every vertex in the merge tree, (IndexType)-1 for the root
+    vector<IndexType> childBegin;     // the children of vertex i are mergeChildren[childBegin[i], childBegin[i+1])
+    vector<IndexType> mergeChildren;
 };
 
 
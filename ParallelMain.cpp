@@ -1,6 +1,8 @@
 #include "MergeTree.h"
 #include <vtkSmartPointer.h>
+#include <vtkIdTypeArray.h>
 #include <vtkXMLImageDataReader.h>
+#include <vtkXMLImageDataWriter.h>
 
 
 const int threadNum = 4;
@@ -9,7 +11,7 @@ int main ( int argc, char *argv[] )
 {
   // parse command line arguments
   if(argc < 2){
-    fprintf(stderr, "Usage: %s Filename(.vti)\n", argv[0]);
+    fprintf(stderr, "Usage: %s Filename(.vti) [Output(.vti)]\n", argv[0]);
     return 1;
   }
 
@@ -33,7 +35,7 @@ int main ( int argc, char *argv[] )
   // Partition the dataset 
   vtkImageData *sgrid = reader->GetOutput();
 
-  // MergeTree globalMergeTree(sgrid);
+  // MergeTree<vtkIdType> globalMergeTree(sgrid);
   // globalMergeTree.build();
   // set<pair<vtkIdType, vtkIdType>> emptySet;
 
@@ -45,17 +47,25 @@ int main ( int argc, char *argv[] )
   // }
   // printf("]\n");
 
-  vector<vector<vtkIdType>> regions;
+  vector<region> regions;
   set<pair<vtkIdType, vtkIdType>> globalBridgeSet;
   auto start = chrono::high_resolution_clock::now();
   decompose(threadNum, sgrid, regions, globalBridgeSet);
   auto stop = chrono::high_resolution_clock::now();
   auto duration = chrono::duration_cast<chrono::milliseconds>(stop - start);
   printf("Decomposition cost: %lld\n", duration.count());
+
+  // the local merge trees use 32-bit local indices
+  for(auto &r : regions){
+    if(r.extent >= numeric_limits<uint32_t>::max()){
+      fprintf(stderr, "The region size should be less than 2^32!\n");
+      return 3;
+    }
+  }
   
   // Test the domain decomposition and global bridge set
   // for(size_t i = 0; i < regions.size(); i++){
-  //   printf("region %zu: <%lld, %lld> \n", i, regions[i].front(), regions[i].back());
+  //   printf("region %zu: <%lld, %lld> \n", i, regions[i].begin, regions[i].end()-1);
   // }
   // printf("\n");
   printf("Size of global bridge set: %zu\n", globalBridgeSet.size());
@@ -71,11 +81,18 @@ int main ( int argc, char *argv[] )
   // }
   
   // Test the reduced global bridge set
-  // vector<vtkIdType> allVertices(sgrid->GetNumberOfPoints());
-  // iota(allVertices.begin(), allVertices.end(), 0);
+  // region allVertices(0, sgrid->GetNumberOfPoints());
   // set<pair<vtkIdType, vtkIdType>> reducedGlobalBS = getReducedBridgeSet(globalBridgeSet, allVertices, sgrid);
   // printf("Size of reduced global bridge set: %zu\n", reducedGlobalBS.size());
 
+  // Steepest-ascent segmentation labels, i.e., the maximum reached by the ascent of each vertex
+  vtkSmartPointer<vtkIdTypeArray> segmentation = vtkSmartPointer<vtkIdTypeArray>::New();
+  segmentation->SetName("Segmentation");
+  segmentation->SetNumberOfTuples(sgrid->GetNumberOfPoints());
+  vtkIdType *labels = segmentation->GetPointer(0);
+  vector<pair<vtkIdType, vtkIdType>> crossings;   // vertices whose ascent leaves their region
+  unordered_map<vtkIdType, vtkIdType> resolvedLabels;
+
   // OpenMP routine
   vector<vtkIdType> maxima;   // use for maxima query
   omp_set_num_threads(threadNum);
@@ -87,7 +104,7 @@ int main ( int argc, char *argv[] )
       // printf("Thread id = %d\n", tid);
 
       // Construct the local merge tree with the vertex set
-      MergeTree localMergeTree(sgrid, regions[tid]);
+      MergeTree<uint32_t> localMergeTree(sgrid, regions[tid]);
       localMergeTree.build();
       
       // Construct the reduced bridge set
@@ -101,8 +118,25 @@ int main ( int argc, char *argv[] )
       auto stop = chrono::high_resolution_clock::now();
       auto duration = chrono::duration_cast<chrono::milliseconds>(stop - start);
       printf("Maxima query cost: %lld\n", duration.count());
+
+      // Label the vertices in the region
+      vector<pair<vtkIdType, vtkIdType>> regionCrossings = steepestAscentSegmentation(sgrid, regions[tid], labels);
+      #pragma omp critical
+        crossings.insert(crossings.end(), regionCrossings.begin(), regionCrossings.end());
     }
 
+    // Resolve the labels across the regions after all the regions are labeled
+    #pragma omp barrier
+    #pragma omp single
+    {
+      for(auto &c : crossings)
+        c.second = labels[c.second];
+      resolvedLabels = resolveLabels(crossings);
+    }
+
+    if(tid < regions.size())
+      relabelRegion(labels, regions[tid], resolvedLabels);
+
     // if(tid s== 0){
     //   nthreads = omp_get_num_threads();
     //   printf("Number of threads = %d\n", nthreads);
@@ -117,5 +151,14 @@ int main ( int argc, char *argv[] )
   }
   printf("]\n");
 
+  sgrid->GetPointData()->AddArray(segmentation);
+  if(argc > 2){
+    vtkSmartPointer<vtkXMLImageDataWriter> writer = vtkSmartPointer<vtkXMLImageDataWriter>::New();
+    writer->SetFileName(argv[2]);
+    writer->SetInputData(sgrid);
+    writer->Write();
+    printf("Segmentation is written to %s\n", argv[2]);
+  }
+
   return 0;
 }
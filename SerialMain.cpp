@@ -32,7 +32,8 @@ int main ( int argc, char *argv[] )
   cout << "There are " << pointNum << " points in the triangulation.\n";
 
   // Create the merge tree here.
-  MergeTree testTree(reader->GetOutput());
+  // The tree covers the whole domain, which may exceed 2^32 vertices.
+  MergeTree<vtkIdType> testTree(reader->GetOutput());
   auto start = chrono::high_resolution_clock::now();
   testTree.build();
   auto stop = chrono::high_resolution_clock::now();
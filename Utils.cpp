@@ -10,28 +10,13 @@ void* getScalar(vtkImageData* sgrid){
   return scalarData;
 }
 
-/**
- * Sort the scalar values while keeping track of the indices.
- */  
-vector<size_t> indexSort(const vector<vtkIdType>& vertexList, vtkImageData* sgrid, bool increasing){
-  float *scalarData = (float*)getScalar(sgrid);
-  vector<size_t> idx(vertexList.size());
-  iota(idx.begin(), idx.end(), 0);
-
-  if(increasing){
-    stable_sort(idx.begin(), idx.end(), [scalarData, vertexList](vtkIdType i1, vtkIdType i2) {return scalarData[vertexList[i1]] < scalarData[vertexList[i2]];});
-  }else{
-    stable_sort(idx.begin(), idx.end(), [scalarData, vertexList](vtkIdType i1, vtkIdType i2) {return scalarData[vertexList[i1]] > scalarData[vertexList[i2]];});
-  }
-  return idx;
-}
-
 /**
  * Sort the scalar values while keeping track of the indices.
  */ 
-vector<vtkIdType> argsort(const vector<vtkIdType>& vertexList, vtkImageData* sgrid, bool increasing){
+vector<vtkIdType> argsort(const region& vertexRange, vtkImageData* sgrid, bool increasing){
   float *scalarData = (float*)getScalar(sgrid);
-  vector<vtkIdType> sortedVertices(vertexList.begin(), vertexList.end());
+  vector<vtkIdType> sortedVertices(vertexRange.extent);
+  iota(sortedVertices.begin(), sortedVertices.end(), vertexRange.begin);
   if(increasing){
     stable_sort(sortedVertices.begin(), sortedVertices.end(), [scalarData](vtkIdType i1, vtkIdType i2) {return scalarData[i1] < scalarData[i2];});
   }else{
@@ -40,31 +25,12 @@ vector<vtkIdType> argsort(const vector<vtkIdType>& vertexList, vtkImageData* sgr
   return sortedVertices;
 }
 
-/**
- * Find the set id of a given vertex id.
- */
-vtkIdType findSet(vector<vtkIdType> &group, vtkIdType i){
-  if(group[i] == -1)
-    return i;
-  group[i] = findSet(group, group[i]);
-  return group[i];
-}
-
-/**
- * Do union of two sets.
- */ 
-void unionSet(vector<vtkIdType> &group, vtkIdType i, vtkIdType j){
-  vtkIdType iset = findSet(group, i);
-  vtkIdType jset = findSet(group, j);
-  if (jset != iset)
-  	group[jset] = iset;
-}
-
 /**
  * Get connected vertices with a given vertex id.
+ * The neighbors are written to the given array, return the number of them.
  */ 
-vector<vtkIdType> getConnectedVertices(vtkIdType id, const vtkImageData *sgrid, int dim[3]){
-  vector<vtkIdType> connectedVertices;
+int getConnectedVertices(vtkIdType id, const vtkImageData *sgrid, int dim[3], vtkIdType neighbors[6]){
+  int count = 0;
   int ids[3];
   ids[0] = id % dim[0];
   ids[2] = id / (dim[0]*dim[1]);
@@ -72,16 +38,16 @@ vector<vtkIdType> getConnectedVertices(vtkIdType id, const vtkImageData *sgrid,
   for(int i = 0; i < 3; i++){
     ids[i] -= 1;
     if(ids[i] >= 0 && ids[i] < dim[i]){
-      connectedVertices.push_back((ids[0]+ids[1]*dim[0]+ids[2]*dim[0]*dim[1]));
+      neighbors[count++] = ids[0]+ids[1]*dim[0]+ids[2]*(vtkIdType)dim[0]*dim[1];
     }
     ids[i] += 2;
     if(ids[i] >= 0 && ids[i] < dim[i]){
-      connectedVertices.push_back((ids[0]+ids[1]*dim[0]+ids[2]*dim[0]*dim[1]));
+      neighbors[count++] = ids[0]+ids[1]*dim[0]+ids[2]*(vtkIdType)dim[0]*dim[1];
     }
     ids[i] -= 1;
   }
 
-  return connectedVertices;
+  return count;
 }
 
 
@@ -89,22 +55,20 @@ vector<vtkIdType> getConnectedVertices(vtkIdType id, const vtkImageData *sgrid,
  * Decompose the domain according to the number of threads.
  * Also create the global bridge set at the same time.
  */ 
-void decompose(int numThreads, vtkImageData *sgrid, vector<vector<vtkIdType>> &regions, set<pair<vtkIdType, vtkIdType>> &gBridgeSet){
+void decompose(int numThreads, vtkImageData *sgrid, vector<region> &regions, set<pair<vtkIdType, vtkIdType>> &gBridgeSet){
 
   // initialize regions
   vtkIdType totalVertices = sgrid->GetNumberOfPoints();
   vtkIdType regionPoints = totalVertices / numThreads;
-  regions = vector<vector<vtkIdType>>(numThreads);
+  regions = vector<region>(numThreads);
 
   vtkIdType startId = 0;
   for(int i = 0; i < numThreads-1; i++){
-    regions[i] = vector<vtkIdType>(regionPoints);
-    iota(regions[i].begin(), regions[i].end(), startId);
+    regions[i] = region(startId, regionPoints);
     startId += regionPoints;
   }
 
-  regions[numThreads-1] = vector<vtkIdType>(regionPoints + totalVertices%numThreads);
-  iota(regions[numThreads-1].begin(), regions[numThreads-1].end(), startId);
+  regions[numThreads-1] = region(startId, regionPoints + totalVertices%numThreads);
 
   // Create the global bridge set
   float *scalars = (float *)getScalar(sgrid);
@@ -133,13 +97,13 @@ void decompose(int numThreads, vtkImageData *sgrid, vector<vector<vtkIdType>> &r
 /**
  * Get the local bridge set.
  */
-set<pair<vtkIdType, vtkIdType>> getLocalBridgeSet(const set<pair<vtkIdType, vtkIdType>> &globalBridgeSet, const vector<vtkIdType> &vertexList){
+set<pair<vtkIdType, vtkIdType>> getLocalBridgeSet(const set<pair<vtkIdType, vtkIdType>> &globalBridgeSet, const region &vertexRange){
   set<pair<vtkIdType, vtkIdType>> localBridgeSet;
   for(auto iter = globalBridgeSet.begin(); iter != globalBridgeSet.end(); iter++){
-    if(iter->first >= vertexList.front() && iter->first <= vertexList.back()){
+    if(vertexRange.contains(iter->first)){
     // if the first vertex is in the region
       localBridgeSet.insert(*iter);
-    }else if(iter->second >= vertexList.front() && iter->second <= vertexList.back()){
+    }else if(vertexRange.contains(iter->second)){
     // if the second vertex is in the region
       localBridgeSet.insert(*iter);
     }
@@ -150,22 +114,24 @@ set<pair<vtkIdType, vtkIdType>> getLocalBridgeSet(const set<pair<vtkIdType, vtkI
 /**
  * Get the reduced bridge set.
  */ 
-set<pair<vtkIdType, vtkIdType>> getReducedBridgeSet(const set<pair<vtkIdType, vtkIdType>> &bridgeSet, const vector<vtkIdType> &vertexList, vtkImageData *sgrid){
+set<pair<vtkIdType, vtkIdType>> getReducedBridgeSet(const set<pair<vtkIdType, vtkIdType>> &bridgeSet, const region &vertexRange, vtkImageData *sgrid){
   // initialize
   int dimension[3];
   sgrid->GetDimensions(dimension);
-  int regionSize = vertexList.size();
+  int regionSize = vertexRange.extent;
   set<pair<vtkIdType, vtkIdType>> reducedBS;
   float *scalars = (float *)getScalar(sgrid);
 
   vector<vtkIdType> component(regionSize, -1);
-  vector<vtkIdType> sortedVertices = argsort(vertexList, sgrid, false);
+  vector<vtkIdType> sortedVertices = argsort(vertexRange, sgrid, false);
 
   // loop the vertex ids in decreasing order
   for(int i = 0; i < regionSize; i++){
     // build the upper link set of the current vertex id
-    vector<vtkIdType> neighbors = getConnectedVertices(sortedVertices[i], sgrid, dimension);
-    for(vtkIdType &vj : neighbors){
+    vtkIdType neighbors[6];
+    int neighborCount = getConnectedVertices(sortedVertices[i], sgrid, dimension, neighbors);
+    for(int n = 0; n < neighborCount; n++){
+      vtkIdType vj = neighbors[n];
       // upper links
       if((scalars[vj] >= scalars[sortedVertices[i]]) || (scalars[vj] == scalars[sortedVertices[i]] && vj > sortedVertices[i])){
         // connect inside region
@@ -176,11 +142,12 @@ set<pair<vtkIdType, vtkIdType>> getReducedBridgeSet(const set<pair<vtkIdType, vt
       }
     }
     // connect between regions
-    for(vtkIdType &vj : neighbors){
+    for(int n = 0; n < neighborCount; n++){
+      vtkIdType vj = neighbors[n];
       if((scalars[vj] >= scalars[sortedVertices[i]]) || (scalars[vj] == scalars[sortedVertices[i]] && vj > sortedVertices[i])){
         if(findSet(component, sortedVertices[i]) != findSet(component, vj)){
           unionSet(component, sortedVertices[i], vj);
-          reducedBS.insert(pair<vtkIdType, vtkIdType>(vertexList[i], vj));
+          reducedBS.insert(pair<vtkIdType, vtkIdType>(vertexRange.begin+i, vj));
         }
       }
     }
@@ -188,3 +155,82 @@ set<pair<vtkIdType, vtkIdType>> getReducedBridgeSet(const set<pair<vtkIdType, vt
 
   return reducedBS;
 }
+
+/**
+ * Steepest-ascent segmentation of the region, independent of the merge tree.
+ * Label every vertex with the maximum reached by its steepest ascent in the mesh, i.e., its
+ * ascending region. The ascent only depends on the neighbors of each vertex, so the labels
+ * do not depend on how the domain is decomposed.
+ * The ascent leaving the region is not followed, the vertex where it leaves labels itself and
+ * is returned together with its higher neighbor outside the region.
+ */
+vector<pair<vtkIdType, vtkIdType>> steepestAscentSegmentation(vtkImageData *sgrid, const region &vertexRange, vtkIdType *labels){
+  int dimension[3];
+  sgrid->GetDimensions(dimension);
+  float* scalarData = (float*) getScalar(sgrid);
+  // compare two vertices, ties are broken by the vertex id as in the bridge set
+  auto higher = [scalarData](vtkIdType a, vtkIdType b){
+    return scalarData[a] > scalarData[b] || (scalarData[a] == scalarData[b] && a > b);
+  };
+
+  // point every vertex to its highest neighbor above it, the maxima point to themselves
+  vector<pair<vtkIdType, vtkIdType>> crossings;
+  vtkIdType neighbors[6];
+  for(vtkIdType vi = vertexRange.begin; vi < vertexRange.end(); vi++){
+    vtkIdType up = vi;
+    int neighborCount = getConnectedVertices(vi, sgrid, dimension, neighbors);
+    for(int n = 0; n < neighborCount; n++){
+      if(higher(neighbors[n], up))
+        up = neighbors[n];
+    }
+    if(!vertexRange.contains(up)){
+      crossings.push_back(pair<vtkIdType, vtkIdType>(vi, up));
+      up = vi;
+    }
+    labels[vi] = up;
+  }
+
+  // follow the pointers to the roots and compress the paths
+  for(vtkIdType vi = vertexRange.begin; vi < vertexRange.end(); vi++){
+    vtkIdType root = labels[vi];
+    while(labels[root] != root)
+      root = labels[root];
+    for(vtkIdType vj = vi; labels[vj] != root; ){
+      vtkIdType next = labels[vj];
+      labels[vj] = root;
+      vj = next;
+    }
+  }
+  return crossings;
+}
+
+/**
+ * Resolve the labels of the vertices whose ascent leaves their region through a bridge edge.
+ * Each pair maps such a vertex to the label of the higher end of its bridge,
+ * follow the pairs until a label which does not continue is reached.
+ */
+unordered_map<vtkIdType, vtkIdType> resolveLabels(const vector<pair<vtkIdType, vtkIdType>> &upLabels){
+  unordered_map<vtkIdType, vtkIdType> up(upLabels.begin(), upLabels.end());
+  unordered_map<vtkIdType, vtkIdType> resolved;
+  for(auto &p : upLabels){
+    // the scalar value increases along the pairs, so the loop terminates
+    vtkIdType root = p.second;
+    for(auto it = up.find(root); it != up.end(); it = up.find(root))
+      root = it->second;
+    resolved[p.first] = root;
+  }
+  return resolved;
+}
+
+/**
+ * Replace the labels of the region with the resolved labels.
+ */
+void relabelRegion(vtkIdType *labels, const region &vertexRange, const unordered_map<vtkIdType, vtkIdType> &resolved){
+  if(resolved.empty())
+    return;
+  for(vtkIdType v = vertexRange.begin; v < vertexRange.end(); v++){
+    auto it = resolved.find(labels[v]);
+    if(it != resolved.end())
+      labels[v] = it->second;
+  }
+}
@@ -7,11 +7,13 @@
 #include <queue>
 #include <vector>
 #include <chrono>
+#include <limits>
 #include <numeric>
 #include <algorithm>
 #include <unordered_map>
 #include <omp.h>
 #include <float.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <vtkCell.h>
 #include <vtkIdList.h>
@@ -23,15 +25,67 @@
 
 using namespace std;
 
+/**
+ * A region of consecutive vertex ids, represented by its first id and its size
+ * instead of a materialized id list.
+ */
+struct region{
+  vtkIdType begin;
+  vtkIdType extent;
+  region():begin(0), extent(0){}
+  region(vtkIdType b, vtkIdType e):begin(b), extent(e){}
+  vtkIdType end() const {return begin + extent;}
+  bool contains(vtkIdType id) const {return id >= begin && id < begin + extent;}
+};
+
 void* getScalar(vtkImageData *);
-vtkIdType findSet(vector<vtkIdType> &, vtkIdType);
-void unionSet(vector<vtkIdType> &, vtkIdType, vtkIdType);
-
-vector<size_t> indexSort(const vector<vtkIdType> &, vtkImageData *, bool=true);
-vector<vtkIdType> argsort(const vector<vtkIdType> &, vtkImageData *, bool=true);
-vector<vtkIdType> getConnectedVertices(vtkIdType, const vtkImageData *, int[3]);
-void decompose(int, vtkImageData *, vector<vector<vtkIdType>> &, set<pair<vtkIdType, vtkIdType>> &);
-set<pair<vtkIdType, vtkIdType>> getLocalBridgeSet(const set<pair<vtkIdType, vtkIdType>> &, const vector<vtkIdType> &);
-set<pair<vtkIdType, vtkIdType>> getReducedBridgeSet(const set<pair<vtkIdType, vtkIdType>> &, const vector<vtkIdType> &, vtkImageData *);
+
+/**
+ * Find the set id of a given index, -1 (i.e., the maximum of IndexType) marks a root.
+ */
+template<typename IndexType>
+IndexType findSet(vector<IndexType> &group, IndexType i){
+  if(group[i] == (IndexType)-1)
+    return i;
+  group[i] = findSet(group, group[i]);
+  return group[i];
+}
+
+/**
+ * Do union of two sets.
+ */
+template<typename IndexType>
+void unionSet(vector<IndexType> &group, IndexType i, IndexType j){
+  IndexType iset = findSet(group, i);
+  IndexType jset = findSet(group, j);
+  if (jset != iset)
+    group[jset] = iset;
+}
+
+/**
+ * Sort the scalar values while keeping track of the region-local indices.
+ */
+template<typename IndexType>
+vector<IndexType> indexSort(const region &vertexRange, vtkImageData *sgrid, bool increasing=true){
+  const float *scalarData = (float*)getScalar(sgrid) + vertexRange.begin;
+  vector<IndexType> idx(vertexRange.extent);
+  iota(idx.begin(), idx.end(), 0);
+
+  if(increasing){
+    stable_sort(idx.begin(), idx.end(), [scalarData](IndexType i1, IndexType i2) {return scalarData[i1] < scalarData[i2];});
+  }else{
+    stable_sort(idx.begin(), idx.end(), [scalarData](IndexType i1, IndexType i2) {return scalarData[i1] > scalarData[i2];});
+  }
+  return idx;
+}
+
+vector<vtkIdType> argsort(const region &, vtkImageData *, bool=true);
+int getConnectedVertices(vtkIdType, const vtkImageData *, int[3], vtkIdType[6]);
+void decompose(int, vtkImageData *, vector<region> &, set<pair<vtkIdType, vtkIdType>> &);
+set<pair<vtkIdType, vtkIdType>> getLocalBridgeSet(const set<pair<vtkIdType, vtkIdType>> &, const region &);
+set<pair<vtkIdType, vtkIdType>> getReducedBridgeSet(const set<pair<vtkIdType, vtkIdType>> &, const region &, vtkImageData *);
+vector<pair<vtkIdType, vtkIdType>> steepestAscentSegmentation(vtkImageData *, const region &, vtkIdType *);
+unordered_map<vtkIdType, vtkIdType> resolveLabels(const vector<pair<vtkIdType, vtkIdType>> &);
+void relabelRegion(vtkIdType *, const region &, const unordered_map<vtkIdType, vtkIdType> &);
 
 #endif